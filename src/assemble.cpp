@@ -22,19 +22,23 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <set>
-#include <regex>
 #include <stdexcept>
 #include <algorithm>
 #include <locale>
 #include <functional>
 #include <cstdint>
 #include <utility>
+#include <vector>
 #include <metronome32/instruction.h>
 #include <metronome32/memory.h>
 #include <metronome32/vm.h>
 #include "assemble.h"
+#include "parallel.h"
+#include "source.h"
+#include "symbols.h"
 #include "transforms.h"
 #include "except.h"
 
@@ -47,34 +51,6 @@ namespace metro32 = metronome32;
 using metro32::register_value;
 using metro32::memory_value;
 
-// Returns whether there are any duplicate labels within a parsed program.
-// If there is a duplicate, the original directive is placed in dup1 and the
-// duplicate directive is placed in dup2.
-static bool has_no_duplicate_labels(
-	const maag32::parse_results& results,
-	maag32::directive& dup1,
-	maag32::directive& dup2) noexcept
-{
-	typedef maag32::parse_results::const_iterator parse_iter;
-	
-	if (results.size() < 2) return true;
-	
-	for (parse_iter i = results.cbegin(); i < results.cend() - 1; i++) {
-		const maag32::directive& dir1 = *i;
-		
-		for (parse_iter j = i + 1; j < results.cend(); j++) {
-			if (dir1.label.size() != 0 and dir1.label == j->label) {
-				dup1 = dir1;
-				dup2 = *j;
-				
-				return false;
-			}
-		}
-	}
-	
-	return true;
-}
-
 // The set of valid mnemonics of actual hardware instructions.
 static const std::set<std::string> valid_realops {
 	"add", "addi", "and", "andi", "beq", "bgez", "bgezal", "bgtz", "blez",
@@ -119,13 +95,13 @@ static long long pseudop_addrdelta_dw(const maag32::directive& dir)
 	} else if (not success2) {
 		throw maag32::invalid_argument(
 			EXCEPT_HEAD,
-			dir.original,
+			dir,
 			"Argument two is not a number."
 		);
 	} else if (arg2 < 0) {
 		throw maag32::underflow_except(
 			EXCEPT_HEAD,
-			dir.original,
+			dir,
 			"Argument two must be at least 0."
 		);
 	} else {
@@ -145,13 +121,13 @@ static long long pseudop_addrdelta_resw(const maag32::directive& dir)
 	} else if (not success1) {
 		throw maag32::invalid_argument(
 			EXCEPT_HEAD,
-			dir.original,
+			dir,
 			"Argument one is not a number."
 		);
 	} else if (arg1 < 0) {
 		throw maag32::underflow_except(
 			EXCEPT_HEAD,
-			dir.original,
+			dir,
 			"Argument one must be at least 0."
 		);
 	} else {
@@ -159,16 +135,11 @@ static long long pseudop_addrdelta_resw(const maag32::directive& dir)
 	}
 }
 
-static const std::regex_constants::syntax_option_type regexopt =
-	std::regex_constants::icase | std::regex_constants::optimize;
-static const std::regex regex_str (maag32::patterns::str, regexopt);
-static const std::regex regex_reg (maag32::patterns::reg, regexopt);
-
 // Returns the size of a pseudo instruction with suffix "s".
 // Strong exception guarantee.
 static long long pseudop_addrdelta_s(const maag32::directive& dir)
 {
-	bool success1 = std::regex_match(dir.data.first, regex_str);
+	bool success1 = maag32::is_string_literal(dir.data.first);
 	bool success2 = true;
 	std::string arg1 = maag32::unescape_chars(dir.data.first);
 	long long arg2 = maag32::tonumber(dir.data.second, success2);
@@ -181,7 +152,7 @@ static long long pseudop_addrdelta_s(const maag32::directive& dir)
 	} else {
 		throw maag32::invalid_argument(
 			EXCEPT_HEAD,
-			dir.original,
+			dir,
 			"Argument one is not a string."
 		);
 	}
@@ -191,13 +162,13 @@ static long long pseudop_addrdelta_s(const maag32::directive& dir)
 	} else if (not success2) {
 		throw maag32::invalid_argument(
 			EXCEPT_HEAD,
-			dir.original,
+			dir,
 			"Argument two is not a number."
 		);
 	} else if (arg2 < 0) {
 		throw maag32::underflow_except(
 			EXCEPT_HEAD,
-			dir.original,
+			dir,
 			"Argument two must be at least 0."
 		);
 	} else {
@@ -212,76 +183,125 @@ static long long pseudop_addrdelta_sz(const maag32::directive& dir)
 	return pseudop_addrdelta_s(dir) + 1;
 }
 
-typedef std::map<std::string, metronome32::register_value> label_addr_map;
+// Returns the lowercase mnemonic of a directive. Mnemonics fit in the small
+// string buffer, so this doesn't allocate.
+static std::string mnemonic(const maag32::directive& dir)
+{
+	std::string instr (dir.instr);
+	std::transform(instr.begin(), instr.end(), instr.begin(), ::tolower);
+	
+	return instr;
+}
 
-// Returns a label_addr_map containing all of the resolved labels of the parsed
-// program.
+// Returns how many words a directive assembles to.
 // Strong exception guarantee.
-static label_addr_map resolve_labels(maag32::parse_results& results)
+static long long directive_size(
+	const maag32::directive& dir,
+	const std::string& instr)
 {
-	label_addr_map resolutions = {};
-	register_value current_addr = 0;
+	if (instr == "") {
+		return 0;
+	} else if (instr == "resw") {
+		return pseudop_addrdelta_resw(dir);
+	} else if (instr == "dw") {
+		return pseudop_addrdelta_dw(dir);
+	} else if (instr == "ress" or instr == "ds") {
+		return pseudop_addrdelta_s(dir);
+	} else if (instr == "ressz" or instr == "dsz") {
+		return pseudop_addrdelta_sz(dir);
+	} else if (valid_realops.count(instr) == 0) {
+		throw maag32::unknown_instruction(
+			EXCEPT_HEAD,
+			dir
+		);
+	} else return 1;
+}
+
+// How many directives make up one task when assembling on several threads.
+static constexpr std::size_t block_size = 1 << 12;
+
+// Returns how many blocks of block_size directives there are.
+static std::size_t count_blocks(const maag32::parse_results& results) noexcept
+{
+	return (results.size() + block_size - 1) / block_size;
+}
+
+// Returns a symbol_table containing all of the resolved labels of the parsed
+// program. The directives are sized in parallel blocks, and their addresses
+// come from a prefix sum of the block sizes.
+// Strong exception guarantee.
+static maag32::symbol_table resolve_labels(
+	maag32::parse_results& results,
+	unsigned threads)
+{
+	maag32::symbol_table resolutions;
+	// The index of the directive defining each symbol.
+	std::vector<std::size_t> definitions;
 	
-	{
-		maag32::directive dir1;
-		maag32::directive dir2;
-		if (not has_no_duplicate_labels(results, dir1, dir2)) {
+	for (std::size_t i = 0; i < results.size(); i++) {
+		const maag32::directive& dir = results[i];
+		maag32::symbol_table::symbol_id id;
+		
+		if (dir.label == "") {
+			continue;
+		} else if (not resolutions.insert(dir.label, 0, id)) {
 			throw maag32::duplicate_label(
 				EXCEPT_HEAD,
-				dir1,
-				dir2
+				results[definitions[id]],
+				dir
 			);
 		}
+		
+		definitions.push_back(i);
 	}
 	
-	for (maag32::directive& dir : results) {
-		if (dir.label != "")
-			resolutions.emplace(dir.label, current_addr);
+	const std::size_t blocks = count_blocks(results);
+	std::vector<register_value> block_addrs (blocks + 1, 0);
+	
+	// Each directive's address temporarily holds its size.
+	maag32::parallel_for(blocks, threads, [&](std::size_t b) {
+		const std::size_t last = std::min((b + 1) * block_size, results.size());
+		register_value total = 0;
 		
-		dir.address = current_addr;
+		for (std::size_t i = b * block_size; i < last; i++) {
+			maag32::directive& dir = results[i];
+			dir.address = directive_size(dir, mnemonic(dir));
+			total += dir.address;
+		}
 		
-		if (dir.instr == "") {
-			continue;
-		} else if (dir.instr == "resw") {
-			current_addr += pseudop_addrdelta_resw(dir);
-		} else if (dir.instr == "dw") {
-			current_addr += pseudop_addrdelta_dw(dir);
-		} else if (dir.instr == "ress" or dir.instr == "ds") {
-			current_addr += pseudop_addrdelta_s(dir);
-		} else if (dir.instr == "ressz" or dir.instr == "dsz") {
-			current_addr += pseudop_addrdelta_sz(dir);
-		} else if (valid_realops.count(dir.instr) == 0) {
-			throw maag32::unknown_instruction(
-				EXCEPT_HEAD,
-				dir
-			);
-		} else current_addr++;
-	}
+		block_addrs[b + 1] = total;
+	});
+	
+	for (std::size_t b = 0; b < blocks; b++)
+		block_addrs[b + 1] += block_addrs[b];
+	
+	maag32::parallel_for(blocks, threads, [&](std::size_t b) {
+		const std::size_t last = std::min((b + 1) * block_size, results.size());
+		register_value current_addr = block_addrs[b];
+		
+		for (std::size_t i = b * block_size; i < last; i++) {
+			maag32::directive& dir = results[i];
+			const register_value size = dir.address;
+			dir.address = current_addr;
+			current_addr += size;
+		}
+	});
+	
+	for (std::size_t id = 0; id < definitions.size(); id++)
+		resolutions.set_value(id, results[definitions[id]].address);
 	
 	return resolutions;
 }
 
-static void lowercase_instr_names(maag32::parse_results& results) noexcept
-{
-	for (maag32::directive& dir : results) {
-		std::transform(
-			dir.instr.begin(),
-			dir.instr.end(),
-			dir.instr.begin(),
-			::tolower
-		);
-	}
-}
-
 static const std::string entry_label = "_ENTRY";
 
-static register_value get_entry_point(const label_addr_map& labels) noexcept
+static register_value get_entry_point(const maag32::symbol_table& labels) \
+	noexcept
 {
-	if (labels.count(entry_label) == 0) {
-		return 0;
-	} else {
-		return labels.at(entry_label);
-	}
+	bool found;
+	const maag32::symbol_table::symbol_id id = labels.find(entry_label, found);
+	
+	return found ? labels.value(id) : 0;
 }
 
 typedef metronome32::gpregister reg_t;
@@ -356,18 +376,18 @@ static constexpr signed long long offminval = -(1 << 16);
 // If success, returns the register number of a register.
 static unsigned long long get_register_num(
 	const maag32::directive& dir,
-	const std::string& str,
+	std::string_view str,
 	bool& success)
 {
-	success = std::regex_match(str, regex_reg);
+	success = maag32::is_register(str);
 	
 	if (success) {
-		unsigned long long num = std::stoull(str.substr(2));
+		unsigned long long num = std::stoull(std::string(str.substr(2)));
 		
 		if (num > regmaxval) {
 			throw maag32::invalid_argument(
 				EXCEPT_HEAD,
-				dir.original,
+				dir,
 				"Register number must be between 0 and " + \
 				std::to_string(regmaxval) + "."
 			);
@@ -378,14 +398,14 @@ static unsigned long long get_register_num(
 // Returns the address referred to by the label if success.
 static memory_value get_label_addr(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
-	const std::string& label,
+	const maag32::symbol_table& labels,
+	std::string_view label,
 	bool& success) noexcept
 {
-	success = labels.count(label) != 0;
+	const maag32::symbol_table::symbol_id id = labels.find(label, success);
 	
 	if (success) {
-		return labels.at(label);
+		return labels.value(id);
 	} else if (label == "_HERE") {
 		success = true;
 		
@@ -396,7 +416,7 @@ static memory_value get_label_addr(
 // Returns the shift/rotate number if success.
 static unsigned long long get_shrot_num(
 	const maag32::directive& dir,
-	const std::string& str,
+	std::string_view str,
 	bool& success)
 {
 	unsigned long long num = maag32::tonumber(str, success);
@@ -405,7 +425,7 @@ static unsigned long long get_shrot_num(
 		if (num > shrotmaxval) {
 			throw maag32::invalid_argument(
 				EXCEPT_HEAD,
-				dir.original,
+				dir,
 				"Shift/rotate amount must be between 0 and " + \
 				std::to_string(shrotmaxval) + "."
 			);
@@ -416,8 +436,8 @@ static unsigned long long get_shrot_num(
 // Returns the immediate number if success.
 static unsigned long long get_imm_num(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
-	const std::string& str,
+	const maag32::symbol_table& labels,
+	std::string_view str,
 	bool& success)
 {
 	signed long long num = maag32::tonumber(str, success);
@@ -426,7 +446,7 @@ static unsigned long long get_imm_num(
 		if (num > immmaxval or num < immminval) {
 			throw maag32::invalid_argument(
 				EXCEPT_HEAD,
-				dir.original,
+				dir,
 				"Immediate must be between " + \
 				std::to_string(immminval) + " and " + \
 				std::to_string(immmaxval) + "."
@@ -440,7 +460,7 @@ static unsigned long long get_imm_num(
 		if (num > immmaxval or num < immminval) {
 			throw maag32::invalid_argument(
 				EXCEPT_HEAD,
-				dir.original,
+				dir,
 				"Immediate must be between " + \
 				std::to_string(immminval) + " and " + \
 				std::to_string(immmaxval) + "."
@@ -452,8 +472,8 @@ static unsigned long long get_imm_num(
 // Returns the offset number if success.
 static unsigned long long get_offset_num(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
-	const std::string& str,
+	const maag32::symbol_table& labels,
+	std::string_view str,
 	bool& success)
 {
 	signed long long num = maag32::tonumber(str, success);
@@ -462,7 +482,7 @@ static unsigned long long get_offset_num(
 		if (num > offmaxval or num < offminval) {
 			throw maag32::invalid_argument(
 				EXCEPT_HEAD,
-				dir.original,
+				dir,
 				"Offset must be between " + \
 				std::to_string(offminval) + " and " + \
 				std::to_string(offmaxval) + "."
@@ -477,7 +497,7 @@ static unsigned long long get_offset_num(
 		if (num > offmaxval or num < offminval) {
 			throw maag32::invalid_argument(
 				EXCEPT_HEAD,
-				dir.original,
+				dir,
 				"Offset must be between " + \
 				std::to_string(offminval) + " and " + \
 				std::to_string(offmaxval) + "."
@@ -489,8 +509,8 @@ static unsigned long long get_offset_num(
 // Returns the target number if success.
 static unsigned long long get_tar_num(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
-	const std::string& str,
+	const maag32::symbol_table& labels,
+	std::string_view str,
 	bool& success)
 {
 	unsigned long long num = maag32::tonumber(str, success);
@@ -499,7 +519,7 @@ static unsigned long long get_tar_num(
 		if (num > tarmaxval) {
 			throw maag32::invalid_argument(
 				EXCEPT_HEAD,
-				dir.original,
+				dir,
 				"Target must be between 0 and " + \
 				std::to_string(tarmaxval) + "."
 			);
@@ -512,7 +532,7 @@ static unsigned long long get_tar_num(
 		if (num > tarmaxval) {
 			throw maag32::invalid_argument(
 				EXCEPT_HEAD,
-				dir.original,
+				dir,
 				"Target must be between 0 and " + \
 				std::to_string(tarmaxval) + "."
 			);
@@ -523,8 +543,8 @@ static unsigned long long get_tar_num(
 // Return the value to fill memory with when using dw.
 static unsigned long long get_dw_num(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
-	const std::string& str,
+	const maag32::symbol_table& labels,
+	std::string_view str,
 	bool& success)
 {
 	unsigned long long num = maag32::tonumber(str, success);
@@ -540,65 +560,65 @@ static unsigned long long get_dw_num(
 // Throws if success is false.
 static void assert_is_reg(
 	const maag32::directive& dir,
-	const std::string& arg,
+	std::string_view arg,
 	bool success)
 {
 	if (not success) throw maag32::invalid_argument(
 		EXCEPT_HEAD,
-		dir.original,
-		"Expected '" + arg + "' to be a register."
+		dir,
+		"Expected '" + std::string(arg) + "' to be a register."
 	);
 }
 
 // Throws if success is false.
 static void assert_is_shrot(
 	const maag32::directive& dir,
-	const std::string& arg,
+	std::string_view arg,
 	bool success)
 {
 	if (not success) throw maag32::invalid_argument(
 		EXCEPT_HEAD,
-		dir.original,
-		"Expected '" + arg + "' to be a shift/rotate amount."
+		dir,
+		"Expected '" + std::string(arg) + "' to be a shift/rotate amount."
 	);
 }
 
 // Throws if success is false.
 static void assert_is_imm(
 	const maag32::directive& dir,
-	const std::string& arg,
+	std::string_view arg,
 	bool success)
 {
 	if (not success) throw maag32::invalid_argument(
 		EXCEPT_HEAD,
-		dir.original,
-		"Expected '" + arg + "' to be an immediate or label."
+		dir,
+		"Expected '" + std::string(arg) + "' to be an immediate or label."
 	);
 }
 
 // Throws if success is false.
 static void assert_is_offset(
 	const maag32::directive& dir,
-	const std::string& arg,
+	std::string_view arg,
 	bool success)
 {
 	if (not success) throw maag32::invalid_argument(
 		EXCEPT_HEAD,
-		dir.original,
-		"Expected '" + arg + "' to be an offset or label."
+		dir,
+		"Expected '" + std::string(arg) + "' to be an offset or label."
 	);
 }
 
 // Throws if success is false.
 static void assert_is_tar(
 	const maag32::directive& dir,
-	const std::string& arg,
+	std::string_view arg,
 	bool success)
 {
 	if (not success) throw maag32::invalid_argument(
 		EXCEPT_HEAD,
-		dir.original,
-		"Expected '" + arg + "' to be a target or label."
+		dir,
+		"Expected '" + std::string(arg) + "' to be a target or label."
 	);
 }
 
@@ -610,7 +630,7 @@ static void assert_regs_unequal(
 {
 	if (reg1 == reg2) throw maag32::invalid_argument(
 		EXCEPT_HEAD,
-		dir.original,
+		dir,
 		"The two provided registers cannot be equal."
 	);
 }
@@ -618,6 +638,7 @@ static void assert_regs_unequal(
 // Creates an instruction of r1 type.
 static void r1_create_instr(
 	const maag32::directive& dir,
+	const std::string& instr,
 	metronome32::context_data& context)
 {
 	bool success = true;
@@ -635,7 +656,7 @@ static void r1_create_instr(
 	assert_is_reg(dir, dir.data.second, success);
 	assert_regs_unequal(dir, reg1, reg2);
 	
-	context.sys_mem[context.counter] = r1_new_instr.at(dir.instr)(
+	context.sys_mem[context.counter] = r1_new_instr.at(instr)(
 		reg1,
 		reg2
 	);
@@ -646,6 +667,7 @@ static void r1_create_instr(
 // Creates an instruction of r1 type.
 static void r2_create_instr(
 	const maag32::directive& dir,
+	const std::string& instr,
 	metronome32::context_data& context)
 {
 	bool success = true;
@@ -662,7 +684,7 @@ static void r2_create_instr(
 	);
 	assert_is_shrot(dir, dir.data.second, success);
 	
-	context.sys_mem[context.counter] = r2_new_instr.at(dir.instr)(
+	context.sys_mem[context.counter] = r2_new_instr.at(instr)(
 		reg,
 		shrot
 	);
@@ -673,7 +695,8 @@ static void r2_create_instr(
 // Creates an instruction of i type.
 static void i_create_instr(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
+	const std::string& instr,
+	const maag32::symbol_table& labels,
 	metronome32::context_data& context)
 {
 	bool success = true;
@@ -691,7 +714,7 @@ static void i_create_instr(
 	);
 	assert_is_imm(dir, dir.data.second, success);
 	
-	context.sys_mem[context.counter] = i_new_instr.at(dir.instr)(
+	context.sys_mem[context.counter] = i_new_instr.at(instr)(
 		reg,
 		imm
 	);
@@ -702,7 +725,8 @@ static void i_create_instr(
 // Creates an instruction of b1 type.
 static void b1_create_instr(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
+	const std::string& instr,
+	const maag32::symbol_table& labels,
 	metronome32::context_data& context)
 {
 	bool success = true;
@@ -720,7 +744,7 @@ static void b1_create_instr(
 	);
 	assert_is_offset(dir, dir.data.second, success);
 	
-	context.sys_mem[context.counter] = b1_new_instr.at(dir.instr)(
+	context.sys_mem[context.counter] = b1_new_instr.at(instr)(
 		reg,
 		offset
 	);
@@ -731,10 +755,11 @@ static void b1_create_instr(
 // Assembles pseudo instructions.
 static void pseudop_create_instr(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
+	const std::string& instr,
+	const maag32::symbol_table& labels,
 	metronome32::context_data& context)
 {
-	if (dir.instr == "dw") {
+	if (instr == "dw") {
 		register_value start = context.counter;
 		const register_value end = start + pseudop_addrdelta_dw(dir);
 		bool success = true;
@@ -747,7 +772,7 @@ static void pseudop_create_instr(
 		
 		if (not success) throw maag32::invalid_argument(
 			EXCEPT_HEAD,
-			dir.original,
+			dir,
 			"Argument one is not a label or number."
 		);
 		
@@ -756,7 +781,7 @@ static void pseudop_create_instr(
 		}
 		
 		context.counter = end;
-	} else if (dir.instr == "ds") {
+	} else if (instr == "ds") {
 		typedef std::string::size_type sindex_t;
 		
 		register_value start = context.counter;
@@ -776,7 +801,7 @@ static void pseudop_create_instr(
 		}
 		
 		context.counter = start;
-	} else if (dir.instr == "dsz") {
+	} else if (instr == "dsz") {
 		typedef std::string::size_type sindex_t;
 		
 		register_value start = context.counter;
@@ -798,11 +823,11 @@ static void pseudop_create_instr(
 		context.sys_mem.insert({start, 0});
 		start++;
 		context.counter = start;
-	} else if (dir.instr == "resw") {
+	} else if (instr == "resw") {
 		context.counter += pseudop_addrdelta_resw(dir);
-	} else if (dir.instr == "ress") {
+	} else if (instr == "ress") {
 		context.counter += pseudop_addrdelta_s(dir);
-	} else if (dir.instr == "ressz") {
+	} else if (instr == "ressz") {
 		context.counter += pseudop_addrdelta_sz(dir);
 	}
 }
@@ -810,28 +835,27 @@ static void pseudop_create_instr(
 // Creates an instruction from a directive.
 static void assemble_instruction(
 	const maag32::directive& dir,
-	const label_addr_map& labels,
+	const maag32::symbol_table& labels,
 	metronome32::context_data& context)
 {
-	std::string first = dir.data.first;
-	std::string second = dir.data.second;
+	const std::string instr = mnemonic(dir);
 	
-	if (dir.instr.size() == 0) {
+	if (instr.size() == 0) {
 		return;
-	} else if (r1_new_instr.count(dir.instr) != 0) {
-		return r1_create_instr(dir, context);
-	} else if (r2_new_instr.count(dir.instr) != 0) {
-		return r2_create_instr(dir, context);
-	} else if (i_new_instr.count(dir.instr) != 0) {
-		return i_create_instr(dir, labels, context);
-	} else if (b1_new_instr.count(dir.instr) != 0) {
-		return b1_create_instr(dir, labels, context);
-	} else if (valid_pseudops.count(dir.instr) != 0) {
-		return pseudop_create_instr(dir, labels, context);
-	} else if (dir.instr == "cf") {
+	} else if (r1_new_instr.count(instr) != 0) {
+		return r1_create_instr(dir, instr, context);
+	} else if (r2_new_instr.count(instr) != 0) {
+		return r2_create_instr(dir, instr, context);
+	} else if (i_new_instr.count(instr) != 0) {
+		return i_create_instr(dir, instr, labels, context);
+	} else if (b1_new_instr.count(instr) != 0) {
+		return b1_create_instr(dir, instr, labels, context);
+	} else if (valid_pseudops.count(instr) != 0) {
+		return pseudop_create_instr(dir, instr, labels, context);
+	} else if (instr == "cf") {
 		context.sys_mem[context.counter] = metronome32::new_cf();
 		context.counter++;
-	} else if (dir.instr == "j") {
+	} else if (instr == "j") {
 		bool success = true;
 		unsigned long long target = get_tar_num(
 			dir,
@@ -848,17 +872,150 @@ static void assemble_instruction(
 	);
 }
 
-maag32::vm maag32::assemble(maag32::parse_results pr)
+maag32::vm maag32::assemble(maag32::parse_results& pr, unsigned threads)
+{
+	if (threads == 0) threads = hardware_threads();
+	
+	maag32::symbol_table labels = resolve_labels(pr, threads);
+	metronome32::context_data context;
+	context.counter = 0;
+	
+	const std::size_t blocks = count_blocks(pr);
+	
+	if (threads > 1 and blocks > 1) {
+		// Each block is encoded into its own image, starting at the
+		// address of its first directive. Every address belongs to one
+		// directive, so merging the images in any order gives the same
+		// memory as encoding serially.
+		std::vector<metronome32::context_data> images (blocks);
+		
+		maag32::parallel_for(blocks, threads, [&](std::size_t b) {
+			const std::size_t first = b * block_size;
+			const std::size_t last = std::min(first + block_size, pr.size());
+			metronome32::context_data& image = images[b];
+			image.counter = pr[first].address;
+			
+			for (std::size_t i = first; i < last; i++) {
+				assemble_instruction(pr[i], labels, image);
+			}
+		});
+		
+		for (const metronome32::context_data& image : images) {
+			for (const auto& word : image.sys_mem) {
+				context.sys_mem.insert(word);
+			}
+		}
+	} else {
+		for (const auto& dir : pr) {
+			assemble_instruction(dir, labels, context);
+		}
+	}
+	
+	context.counter = get_entry_point(labels);
+	maag32::vm my_vm;
+	my_vm.set_context(std::forward<metronome32::context_data>(context));
+	
+	return my_vm;
+}
+
+// Throws duplicate_label for a directive redefining a label, rescanning the
+// source for the first definition since streaming doesn't keep it.
+[[noreturn]] static void throw_duplicate_label(
+	maag32::source_reader& reader,
+	const maag32::directive& dup)
+{
+	const std::string original (dup.original);
+	const std::string label (dup.label);
+	maag32::directive second;
+	second.original = original;
+	second.label = label;
+	second.line = dup.line;
+	second.column = dup.column;
+	
+	std::string_view chunk;
+	std::size_t line = 1;
+	reader.rewind();
+	
+	while (reader.next(chunk)) {
+		maag32::directive_scanner scanner (chunk, line);
+		maag32::directive first;
+		
+		while (scanner.next(first)) {
+			if (first.label == label) throw maag32::duplicate_label(
+				EXCEPT_HEAD,
+				first,
+				second
+			);
+		}
+		
+		line = scanner.line();
+	}
+	
+	throw maag32::duplicate_label(EXCEPT_HEAD, second, second);
+}
+
+// Resolves the labels of a source by scanning it once, chunk by chunk.
+// Returns false if the source isn't valid.
+// Strong exception guarantee.
+static bool resolve_labels(
+	maag32::source_reader& reader,
+	maag32::symbol_table& resolutions)
+{
+	register_value current_addr = 0;
+	std::string_view chunk;
+	std::size_t line = 1;
+	
+	if (not reader.rewind()) return false;
+	
+	while (reader.next(chunk)) {
+		maag32::directive_scanner scanner (chunk, line);
+		maag32::directive dir;
+		
+		while (scanner.next(dir)) {
+			maag32::symbol_table::symbol_id id;
+			
+			if (dir.label != "" and \
+				not resolutions.insert(dir.label, current_addr, id))
+				throw_duplicate_label(reader, dir);
+			
+			current_addr += directive_size(dir, mnemonic(dir));
+		}
+		
+		if (scanner.failed()) return false;
+		line = scanner.line();
+	}
+	
+	return not reader.failed();
+}
+
+maag32::vm maag32::assemble_stream(
+	maag32::source_reader& reader,
+	bool& success)
 {
-	lowercase_instr_names(pr);
-	label_addr_map labels = resolve_labels(pr);
+	maag32::symbol_table labels;
+	success = resolve_labels(reader, labels) and reader.rewind();
+	if (not success) return {};
+	
 	metronome32::context_data context;
 	context.counter = 0;
+	std::string_view chunk;
+	std::size_t line = 1;
 	
-	for (const auto& dir : pr) {
-		assemble_instruction(dir, labels, context);
+	while (reader.next(chunk)) {
+		maag32::directive_scanner scanner (chunk, line);
+		maag32::directive dir;
+		
+		while (scanner.next(dir)) {
+			dir.address = context.counter;
+			assemble_instruction(dir, labels, context);
+		}
+		
+		line = scanner.line();
 	}
 	
+	success = not reader.failed();
+	if (not success) return {};
+	
 	context.counter = get_entry_point(labels);
 	maag32::vm my_vm;
 	my_vm.set_context(std::forward<metronome32::context_data>(context));
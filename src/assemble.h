@@ -22,16 +22,25 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #ifndef METROAAG32_HEADER_ASSEMBLE
-#define METROAGG32_HEADER_ASSEMBLE
+#define METROAAG32_HEADER_ASSEMBLE
 #include <metronome32/vm.h>
+#include "source.h"
 #include "transforms.h"
 
 namespace metroaag32 {
 	typedef metronome32::vm vm;
 	
 	// Returns a Metronome32 VM context from the results of a parsed
-	// program.
-	vm assemble(parse_results pr);
+	// program. Fills in the address of every directive. Large programs
+	// are sized and encoded on up to threads threads (0 meaning one per
+	// core), with the same results as assembling on one.
+	vm assemble(parse_results& pr, unsigned threads = 1);
+	// Returns a Metronome32 VM context from a source file, holding only its
+	// labels and one chunk of it in memory at a time. The file is read
+	// twice: once to resolve labels and once to encode. If the source
+	// isn't valid, or reading failed (see reader.failed()), success is
+	// false.
+	vm assemble_stream(source_reader& reader, bool& success);
 }
 
 #endif
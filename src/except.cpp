@@ -33,13 +33,21 @@ maag32::exception::exception() noexcept
 	: maag32::exception::exception("Undefined MetroAAG32 error")
 {}
 
+// Returns where a directive is in its source, for messages.
+static std::string position(const maag32::directive& dir)
+{
+	return "line " + std::to_string(dir.line) + ", column " + \
+		std::to_string(dir.column);
+}
+
 maag32::invalid_argument::invalid_argument(
 	const std::string& head,
-	const std::string& line,
+	const maag32::directive& dir,
 	const std::string& why
 ) noexcept
 	: maag32::invalid_argument::invalid_argument(head + \
-		"Line:\t" + line + "\n" + why
+		"At " + position(dir) + ":\t" + std::string(dir.original) + \
+		"\n" + why
 	)
 {}
 
@@ -48,7 +56,8 @@ maag32::unknown_instruction::unknown_instruction(
 	const maag32::directive& dir
 ) noexcept
 	: maag32::unknown_instruction::unknown_instruction(head + \
-		"Unknown instruction:\nDirective:\n\t" + dir.original
+		"Unknown instruction:\nDirective (" + position(dir) + "):\n\t" + \
+		std::string(dir.original)
 	)
 {}
 
@@ -58,8 +67,10 @@ maag32::duplicate_label::duplicate_label(
 	const maag32::directive& dup2
 ) noexcept
 	: maag32::duplicate_label::duplicate_label(head + \
-		"Duplicate labels found:\nDirective one:\n\t" + dup1.original + \
-		"\n\nDirective two:\n\t" + dup2.original
+		"Duplicate labels found:\nDirective one (" + position(dup1) + \
+		"):\n\t" + std::string(dup1.original) + \
+		"\n\nDirective two (" + position(dup2) + "):\n\t" + \
+		std::string(dup2.original)
 	)
 {}
 
@@ -69,7 +80,8 @@ maag32::incorrect_arg_num::incorrect_arg_num(
 	unsigned long long correct_num
 ) noexcept
 	: maag32::exception::exception(head + \
-		"Incorrect number of arguments provided:\n\t" + dir.original + \
+		"Incorrect number of arguments provided (" + position(dir) + \
+		"):\n\t" + std::string(dir.original) + \
 		"\n\tExpect arg number: " + std::to_string(correct_num)
 	)
 {}
@@ -64,7 +64,7 @@ class metroaag32::invalid_argument : public metroaag32::exception
 	public:
 		invalid_argument(
 			const std::string& head,
-			const std::string& line,
+			const directive& dir,
 			const std::string& why
 		) noexcept;
 		invalid_argument(const invalid_argument&) noexcept
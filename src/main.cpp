@@ -24,14 +24,19 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <climits>
 #include <cstdlib>
 #include <unistd.h>
+#include <getopt.h>
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <utility>
 #include <metronome32/vm.h>
+#include "source.h"
 #include "transforms.h"
 #include "assemble.h"
 namespace maag32 = metroaag32;
 
+// The path that reads the source from stdin.
+static const std::string stdin_path = "-";
+
 namespace warnmsg {
 	static const std::string multiarg =
 		"Warning: only the first argument is used.";
@@ -46,8 +51,24 @@ namespace errmsg {
 		"No argument provided.";
 	static const std::string notsource =
 		"Provided file doesn't contain valid source code.";
+	static const std::string usage =
+		"Usage: maag32 [--stream] [--threads N] FILE";
+	static const std::string badthreads =
+		"The thread count must be a number of at least 0.";
 }
 
+// The options given on the command line.
+struct driver_options {
+	// Assemble in two streaming passes rather than loading the whole
+	// source, so that memory use follows the label count.
+	bool stream = false;
+	// How many threads to assemble on, with 0 meaning one per core.
+	unsigned threads = 0;
+	std::string path;
+};
+
+driver_options parse_options(const int argc, char** argv);
+
 std::string get_realpath(const std::string& path, bool& success)
 {
 	char resolved[PATH_MAX];
@@ -64,22 +85,6 @@ std::string get_realpath(const std::string& path, bool& success)
 	}
 }
 
-std::string get_file_contents(const std::string& rp, bool& success)
-{
-	std::string contents;
-	std::ifstream fst(rp, std::ios::binary);
-	
-	success = fst.is_open();
-	
-	while (fst.good() and fst.is_open()) {
-		contents += fst.get();
-	}
-	
-	contents.erase(contents.cend() - 1, contents.cend());
-
-	return contents;
-}
-
 void error(const std::string& str)
 {
 	std::cout << str << std::endl;
@@ -106,31 +111,87 @@ void print_counter(const metronome32::vm& vm)
 	std::cout << std::hex << " (0x" << counter << ")" << std::endl;
 }
 
-metronome32::vm load_file_and_assemble(const int argc, const char** argv)
+driver_options parse_options(const int argc, char** argv)
 {
-	if (argc > 2) {
+	static const option long_options[] = {
+		{"stream", no_argument, nullptr, 's'},
+		{"threads", required_argument, nullptr, 'j'},
+		{nullptr, 0, nullptr, 0}
+	};
+	driver_options opts;
+	int opt = 0;
+	bool success = true;
+	
+	while ((opt = getopt_long(argc, argv, "sj:", long_options, nullptr)) != -1) {
+		switch (opt) {
+			case 's':
+				opts.stream = true;
+				break;
+			case 'j': {
+				const long long threads = maag32::tonumber(optarg, success);
+				if (not success or threads < 0) error(errmsg::badthreads);
+				opts.threads = threads;
+				break;
+			}
+			default:
+				error(errmsg::usage);
+		}
+	}
+	
+	if (argc - optind > 1) {
 		std::cout << warnmsg::multiarg << std::endl;
-	} else if (argc < 2) error(errmsg::expectingarg);
+	} else if (argc - optind < 1) error(errmsg::expectingarg);
 	
-	std::string file_path = argv[1];
-	bool success = true;
-	std::string real_path = get_realpath(file_path, success);
-	if (not success) error(errmsg::realpathfail);
+	opts.path = argv[optind];
 	
-	std::string file_data = get_file_contents(real_path, success);
+	return opts;
+}
+
+// Assembles a source in two passes over the file, never loading all of it.
+metronome32::vm stream_and_assemble(const std::string& real_path)
+{
+	maag32::source_reader reader;
+	bool success = reader.open(real_path);
 	if (not success) error(errmsg::filenonexist);
 	
-	bool is_valid_source = maag32::consists_of_directives(file_data);
-	if (not is_valid_source) error(errmsg::notsource);
+	auto vm = maag32::assemble_stream(reader, success);
+	if (reader.failed()) error(errmsg::filenonexist);
+	if (not success) error(errmsg::notsource);
+	
+	return vm;
+}
+
+metronome32::vm load_file_and_assemble(const driver_options& opts)
+{
+	bool success = true;
+	std::string real_path = opts.path;
+	
+	if (opts.path != stdin_path) {
+		real_path = get_realpath(opts.path, success);
+		if (not success) error(errmsg::realpathfail);
+	}
+	
+	// Streaming needs to rewind, so stdin is always loaded.
+	if (opts.stream and opts.path != stdin_path) {
+		return stream_and_assemble(real_path);
+	}
+	
+	auto file_data = maag32::load_source(real_path, success);
+	if (not success) error(errmsg::filenonexist);
 	
-	maag32::parse_results results = maag32::parse_source(file_data);
+	maag32::parse_results results = maag32::parse_source(
+		std::move(file_data),
+		success,
+		opts.threads
+	);
+	if (not success) error(errmsg::notsource);
 	
-	return maag32::assemble(results);
+	return maag32::assemble(results, opts.threads);
 }
 
-int main(const int argc, const char** argv)
+int main(const int argc, char** argv)
 {
-	auto vm = load_file_and_assemble(argc, argv);
+	auto vm = load_file_and_assemble(parse_options(argc, argv));
 	constexpr metronome32::context_error naidef = \
 		metronome32::context_error::naidefault;
 	unsigned int steps = 0;
@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2019 Grayson Burton ( https://github.com/ocornoc/ )
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+namespace maag32 = metroaag32;
+
+unsigned maag32::hardware_threads() noexcept
+{
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void maag32::parallel_for(
+	std::size_t count,
+	unsigned threads,
+	const std::function<void(std::size_t)>& task)
+{
+	if (threads == 0) threads = hardware_threads();
+	if (threads > count) threads = count;
+	
+	if (threads <= 1) {
+		for (std::size_t i = 0; i < count; i++) task(i);
+		
+		return;
+	}
+	
+	std::atomic<std::size_t> next (0);
+	std::vector<std::exception_ptr> errors (count);
+	const auto work = [&]() {
+		for (std::size_t i = next++; i < count; i = next++) {
+			try {
+				task(i);
+			} catch (...) {
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	
+	for (unsigned t = 1; t < threads; t++) pool.emplace_back(work);
+	work();
+	for (std::thread& th : pool) th.join();
+	
+	for (const std::exception_ptr& error : errors) {
+		if (error) std::rethrow_exception(error);
+	}
+}
@@ -0,0 +1,44 @@
+/*
+Copyright (c) 2019 Grayson Burton ( https://github.com/ocornoc/ )
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef METROAAG32_HEADER_PARALLEL
+#define METROAAG32_HEADER_PARALLEL
+#include <cstddef>
+#include <functional>
+
+namespace metroaag32 {
+	// Returns how many threads the machine can run at once, at least 1.
+	unsigned hardware_threads() noexcept;
+	// Calls task(i) for every i in [0, count) on up to threads threads,
+	// with 0 meaning hardware_threads(). Tasks are handed out in index
+	// order as threads free up. If any tasks throw, the exception of the
+	// lowest-indexed one is rethrown once all tasks are done, just like a
+	// serial loop would have thrown it.
+	void parallel_for(
+		std::size_t count,
+		unsigned threads,
+		const std::function<void(std::size_t)>& task
+	);
+}
+
+#endif
@@ -0,0 +1,229 @@
+/*
+Copyright (c) 2019 Grayson Burton ( https://github.com/ocornoc/ )
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.h"
+
+namespace maag32 = metroaag32;
+
+// How much to read at a time when a source can't be mapped.
+static constexpr std::size_t read_chunk = 1 << 16;
+
+maag32::source_buffer::source_buffer(std::string str) noexcept
+	: owned(std::move(str))
+{}
+
+maag32::source_buffer::source_buffer(const void* map, std::size_t len) \
+	noexcept
+	: mapped(static_cast<const char*>(map)), mapped_size(len)
+{}
+
+maag32::source_buffer::~source_buffer()
+{
+	if (mapped) munmap(const_cast<char*>(mapped), mapped_size);
+}
+
+const char* maag32::source_buffer::data() const noexcept
+{
+	return mapped ? mapped : owned.data();
+}
+
+std::size_t maag32::source_buffer::size() const noexcept
+{
+	return mapped ? mapped_size : owned.size();
+}
+
+std::string_view maag32::source_buffer::view() const noexcept
+{
+	return std::string_view(data(), size());
+}
+
+bool maag32::source_buffer::is_mapped() const noexcept
+{
+	return mapped != nullptr;
+}
+
+// Reads everything left in a file descriptor. Used for pipes, terminals and
+// anything else that can't be mapped.
+static bool read_all(int fd, std::size_t size_hint, std::string& contents)
+{
+	contents.reserve(size_hint);
+	
+	for (;;) {
+		const std::size_t old_size = contents.size();
+		contents.resize(old_size + read_chunk);
+		const ssize_t got = read(fd, &contents[old_size], read_chunk);
+		
+		if (got < 0 and errno == EINTR) {
+			contents.resize(old_size);
+		} else if (got < 0) {
+			return false;
+		} else {
+			contents.resize(old_size + got);
+			if (got == 0) return true;
+		}
+	}
+}
+
+std::shared_ptr<const maag32::source_buffer> maag32::load_source(
+	const std::string& path,
+	bool& success)
+{
+	const bool is_stdin = path == "-";
+	const int fd = is_stdin ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+	struct stat st;
+	
+	success = fd >= 0 and fstat(fd, &st) == 0;
+	if (not success) {
+		if (fd >= 0 and not is_stdin) close(fd);
+		
+		return nullptr;
+	}
+	
+	std::shared_ptr<const source_buffer> buffer;
+	
+	if (S_ISREG(st.st_mode) and st.st_size > 0) {
+		void* map = mmap(
+			nullptr,
+			st.st_size,
+			PROT_READ,
+			MAP_PRIVATE,
+			fd,
+			0
+		);
+		
+		if (map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			buffer = std::make_shared<const source_buffer>(map, st.st_size);
+		}
+	}
+	
+	if (not buffer) {
+		std::string contents;
+		const std::size_t hint = S_ISREG(st.st_mode) ? st.st_size : 0;
+		success = read_all(fd, hint, contents);
+		buffer = std::make_shared<const source_buffer>(std::move(contents));
+	}
+	
+	if (not is_stdin) close(fd);
+	
+	return buffer;
+}
+
+maag32::source_reader::source_reader(std::size_t chunk_size) noexcept
+	: target(chunk_size)
+{}
+
+maag32::source_reader::~source_reader()
+{
+	if (fd >= 0) close(fd);
+}
+
+bool maag32::source_reader::open(const std::string& path)
+{
+	struct stat st;
+	
+	if (fd >= 0) close(fd);
+	fd = ::open(path.c_str(), O_RDONLY);
+	
+	if (fd < 0 or fstat(fd, &st) != 0 or not S_ISREG(st.st_mode)) {
+		if (fd >= 0) close(fd);
+		fd = -1;
+		
+		return false;
+	}
+	
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	
+	return rewind();
+}
+
+bool maag32::source_reader::next(std::string_view& chunk)
+{
+	if (fd < 0 or bad) return false;
+	
+	buffer.erase(0, consumed);
+	consumed = 0;
+	
+	for (;;) {
+		std::size_t nl = std::string::npos;
+		
+		if (buffer.size() >= target or at_eof) {
+			nl = buffer.rfind('\n');
+		}
+		
+		if (nl != std::string::npos) {
+			consumed = nl + 1;
+		} else if (at_eof) {
+			consumed = buffer.size();
+		}
+		
+		if (consumed != 0) {
+			chunk = std::string_view(buffer.data(), consumed);
+			
+			return true;
+		} else if (at_eof) return false;
+		
+		const std::size_t old_size = buffer.size();
+		const std::size_t want = std::max(target - std::min(target, old_size),
+			read_chunk);
+		buffer.resize(old_size + want);
+		const ssize_t got = read(fd, &buffer[old_size], want);
+		
+		if (got < 0) {
+			buffer.resize(old_size);
+			if (errno == EINTR) continue;
+			bad = true;
+			
+			return false;
+		}
+		
+		buffer.resize(old_size + got);
+		at_eof = got == 0;
+	}
+}
+
+bool maag32::source_reader::rewind()
+{
+	buffer.clear();
+	consumed = 0;
+	at_eof = false;
+	bad = fd < 0 or lseek(fd, 0, SEEK_SET) != 0;
+	
+	return not bad;
+}
+
+bool maag32::source_reader::failed() const noexcept
+{
+	return bad;
+}
@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2019 Grayson Burton ( https://github.com/ocornoc/ )
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef METROAAG32_HEADER_SOURCE
+#define METROAAG32_HEADER_SOURCE
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace metroaag32 {
+	// The read-only bytes of a source. Files are mapped into memory where
+	// possible, and read in bulk otherwise.
+	class source_buffer;
+	
+	// Reads a source file front to back in chunks of whole lines, so that
+	// it never needs to be in memory all at once.
+	class source_reader;
+	
+	// Loads the source at a path, with "-" meaning stdin. Only
+	// well-defined if success is true.
+	std::shared_ptr<const source_buffer> load_source(
+		const std::string& path,
+		bool& success
+	);
+}
+
+class metroaag32::source_buffer
+{
+	public:
+		source_buffer() noexcept
+			= default;
+		// Takes ownership of the bytes of a string.
+		explicit source_buffer(std::string str) noexcept;
+		// Takes ownership of a mapping made by mmap().
+		source_buffer(const void* map, std::size_t len) noexcept;
+		source_buffer(const source_buffer&)
+			= delete;
+		source_buffer& operator=(const source_buffer&)
+			= delete;
+		~source_buffer();
+		
+		const char* data() const noexcept;
+		std::size_t size() const noexcept;
+		std::string_view view() const noexcept;
+		// Whether the bytes are a mapping of the file.
+		bool is_mapped() const noexcept;
+	
+	private:
+		std::string owned;
+		const char* mapped = nullptr;
+		std::size_t mapped_size = 0;
+};
+
+class metroaag32::source_reader
+{
+	public:
+		// Chunks are at least chunk_size bytes, except for the last one,
+		// unless a line is longer than that.
+		explicit source_reader(std::size_t chunk_size = 1 << 20) noexcept;
+		source_reader(const source_reader&)
+			= delete;
+		source_reader& operator=(const source_reader&)
+			= delete;
+		~source_reader();
+		
+		// Opens a regular file. Returns false if it can't be opened or
+		// can't be rewound.
+		bool open(const std::string& path);
+		// Places the next chunk in chunk. It's valid until the next
+		// call. Returns false at the end of the file or on a read error.
+		bool next(std::string_view& chunk);
+		// Goes back to the start of the file.
+		bool rewind();
+		// Whether reading stopped because of an error.
+		bool failed() const noexcept;
+	
+	private:
+		int fd = -1;
+		std::size_t target;
+		std::string buffer;
+		std::size_t consumed = 0;
+		bool at_eof = false;
+		bool bad = false;
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+Copyright (c) 2019 Grayson Burton ( https://github.com/ocornoc/ )
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "symbols.h"
+
+namespace maag32 = metroaag32;
+
+// The table grows once it's half full.
+static constexpr std::size_t max_load_divisor = 2;
+static constexpr std::size_t min_slots = 16;
+
+// 64-bit FNV-1a.
+static std::uint64_t hash_name(std::string_view name) noexcept
+{
+	std::uint64_t hash = 0xcbf29ce484222325ull;
+	
+	for (const char c : name) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3ull;
+	}
+	
+	return hash;
+}
+
+std::size_t maag32::symbol_table::probe(
+	std::string_view name,
+	std::uint64_t hash) const noexcept
+{
+	const std::size_t mask = slots.size() - 1;
+	
+	for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+		if (slots[i] == 0) return i;
+		
+		const entry& e = entries[slots[i] - 1];
+		
+		if (e.hash == hash and e.name_size == name.size() and \
+			names.compare(e.name_offset, e.name_size, name) == 0)
+			return i;
+	}
+}
+
+void maag32::symbol_table::rehash(std::size_t slot_count)
+{
+	const std::size_t mask = slot_count - 1;
+	slots.assign(slot_count, 0);
+	
+	for (std::size_t id = 0; id < entries.size(); id++) {
+		std::size_t i = entries[id].hash & mask;
+		while (slots[i] != 0) i = (i + 1) & mask;
+		slots[i] = id + 1;
+	}
+}
+
+bool maag32::symbol_table::insert(
+	std::string_view name,
+	value_type value,
+	symbol_id& id)
+{
+	if (entries.size() == UINT32_MAX)
+		throw std::length_error("Too many symbols.");
+	if ((entries.size() + 1) * max_load_divisor > slots.size())
+		reserve(entries.size() + 1);
+	
+	const std::uint64_t hash = hash_name(name);
+	const std::size_t slot = probe(name, hash);
+	
+	if (slots[slot] != 0) {
+		id = slots[slot] - 1;
+		
+		return false;
+	}
+	
+	id = entries.size();
+	entries.push_back({hash, names.size(), name.size(), value});
+	names.append(name);
+	slots[slot] = id + 1;
+	
+	return true;
+}
+
+maag32::symbol_table::symbol_id maag32::symbol_table::find(
+	std::string_view name,
+	bool& success) const noexcept
+{
+	if (entries.empty()) {
+		success = false;
+		
+		return 0;
+	}
+	
+	const std::size_t slot = probe(name, hash_name(name));
+	success = slots[slot] != 0;
+	
+	return success ? slots[slot] - 1 : 0;
+}
+
+std::string_view maag32::symbol_table::name(symbol_id id) const noexcept
+{
+	const entry& e = entries[id];
+	
+	return std::string_view(names).substr(e.name_offset, e.name_size);
+}
+
+maag32::symbol_table::value_type maag32::symbol_table::value(symbol_id id) \
+	const noexcept
+{
+	return entries[id].value;
+}
+
+void maag32::symbol_table::set_value(symbol_id id, value_type value) noexcept
+{
+	entries[id].value = value;
+}
+
+std::size_t maag32::symbol_table::size() const noexcept
+{
+	return entries.size();
+}
+
+void maag32::symbol_table::reserve(std::size_t count)
+{
+	std::size_t slot_count = min_slots;
+	
+	while (slot_count < count * max_load_divisor) slot_count *= 2;
+	if (slot_count <= slots.size()) return;
+	
+	entries.reserve(count);
+	rehash(slot_count);
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2019 Grayson Burton ( https://github.com/ocornoc/ )
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef METROAAG32_HEADER_SYMBOLS
+#define METROAAG32_HEADER_SYMBOLS
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <metronome32/instruction.h>
+
+namespace metroaag32 {
+	// Maps label names to addresses. It's a flat open-addressing hash
+	// table that keeps its own copy of the names, so a lookup is a single
+	// probe sequence and adding a label doesn't allocate on its own.
+	class symbol_table;
+}
+
+class metroaag32::symbol_table
+{
+	public:
+		// Symbols are numbered from 0 in the order they're added.
+		typedef std::size_t symbol_id;
+		typedef metronome32::register_value value_type;
+		
+		symbol_table() noexcept
+			= default;
+		
+		// Adds a symbol and places its ID in id. If the name is already
+		// taken, nothing is added, id is the existing symbol, and false
+		// is returned.
+		bool insert(std::string_view name, value_type value, symbol_id& id);
+		// Returns the ID of a symbol if success.
+		symbol_id find(std::string_view name, bool& success) const noexcept;
+		std::string_view name(symbol_id id) const noexcept;
+		value_type value(symbol_id id) const noexcept;
+		void set_value(symbol_id id, value_type value) noexcept;
+		// The number of symbols.
+		std::size_t size() const noexcept;
+		// Makes room for count symbols without rehashing.
+		void reserve(std::size_t count);
+	
+	private:
+		struct entry {
+			std::uint64_t hash;
+			std::size_t name_offset;
+			std::size_t name_size;
+			value_type value;
+		};
+		
+		// Returns the slot that holds name, or the empty slot it would go in.
+		std::size_t probe(std::string_view name, std::uint64_t hash) const \
+			noexcept;
+		void rehash(std::size_t slot_count);
+		
+		// Each slot holds an index into entries plus 1, or 0 if empty.
+		std::vector<std::uint32_t> slots;
+		std::vector<entry> entries;
+		std::string names;
+};
+
+#endif
@@ -21,141 +21,678 @@ OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <algorithm>
 #include <string>
-#include <regex>
-#include <map>
 #include <vector>
 #include <utility>
+#include <cstring>
 #include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "transforms.h"
+#include "parallel.h"
 namespace maag32 = metroaag32;
-namespace maag32pat = maag32::patterns;
-using std::regex;
-namespace regexc = std::regex_constants;
 
-typedef regexc::syntax_option_type regexopt;
-typedef std::map<std::string, std::string> escape_map;
+// Returns the character that a backslash escape stands for, or '\0' if c
+// doesn't complete one.
+static char unescaped(char c) noexcept
+{
+	switch (c) {
+		case 'a': return '\a';
+		case 'b': return '\b';
+		case '?': return '\?';
+		case 'f': return '\f';
+		case 'n': return '\n';
+		case 'r': return '\r';
+		case 't': return '\t';
+		case 'v': return '\v';
+		case '\\': return '\\';
+		default: return '\0';
+	}
+}
+
+std::string maag32::unescape_chars(std::string_view str)
+{
+	typedef std::string_view::size_type sindex_t;
+	std::string newstr;
+	newstr.reserve(str.size());
+	
+	for (sindex_t i = 0; i < str.size(); ++i) {
+		const char c = i + 1 < str.size() and str[i] == '\\' ?
+			unescaped(str[i + 1]) : '\0';
+		
+		if (c != '\0') {
+			newstr += c;
+			++i;
+		} else {
+			newstr += str[i];
+		}
+	}
+	
+	return newstr;
+}
+
+// The scanner below walks raw character ranges and never backtracks more
+// than a single line, so validating and parsing a source is linear in its
+// size.
+
+static inline bool is_hws(char c) noexcept
+{
+	return c == ' ' or c == '\t';
+}
+
+static inline bool is_digit(char c) noexcept
+{
+	return c >= '0' and c <= '9';
+}
+
+static inline bool is_hex_digit(char c) noexcept
+{
+	return is_digit(c) or (c >= 'a' and c <= 'f') or (c >= 'A' and c <= 'F');
+}
+
+static inline bool is_name_start(char c) noexcept
+{
+	return c == '_' or (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z');
+}
+
+static inline bool is_name_char(char c) noexcept
+{
+	return is_name_start(c) or is_digit(c);
+}
+
+static inline bool is_quote(char c) noexcept
+{
+	return c == '"' or c == '\'';
+}
+
+static inline const char* skip_hws(const char* p, const char* end) noexcept
+{
+	while (p < end and is_hws(*p)) ++p;
+	
+	return p;
+}
+
+// Returns the end of the name starting at p, or nullptr if there is none.
+static const char* scan_name(const char* p, const char* end) noexcept
+{
+	if (p == end or not is_name_start(*p)) return nullptr;
+	
+	for (;;) {
+		++p;
+		while (p < end and is_name_char(*p)) ++p;
+		
+		if (p + 1 < end and *p == '.' and is_name_start(p[1])) {
+			++p;
+		} else return p;
+	}
+}
+
+// Returns the end of the number starting at p, or nullptr if there is none.
+static const char* scan_number(const char* p, const char* end) noexcept
+{
+	if (p < end and (*p == '+' or *p == '-')) ++p;
+	if (p == end or not is_digit(*p)) return nullptr;
+	
+	if (*p == '0' and p + 2 < end and (p[1] == 'x' or p[1] == 'X') \
+		and is_hex_digit(p[2])) {
+		p += 2;
+		while (p < end and is_hex_digit(*p)) ++p;
+	} else {
+		while (p < end and is_digit(*p)) ++p;
+	}
+	
+	return p;
+}
+
+// Returns the end of the register starting at p, or nullptr if there is
+// none.
+static const char* scan_register(const char* p, const char* end) noexcept
+{
+	if (end - p < 3 or p[0] != '%' or (p[1] != 'r' and p[1] != 'R'))
+		return nullptr;
+	if (not is_digit(p[2])) return nullptr;
+	if (p + 3 < end and is_digit(p[3])) return p + 4;
+	
+	return p + 3;
+}
 
-static const escape_map unescape = {
-	{"\\a", "\a"}, {"\\b", "\b"}, {"\\?", "\?"},
-	{"\\f", "\f"}, {"\\n", "\n"}, {"\\r", "\r"},
-	{"\\t", "\t"}, {"\\v", "\v"}, {"\\\\", "\\"},
+// Returns the next possible closing quote of the string starting at open,
+// after the candidate prev, or nullptr if there are no more. Strings can't
+// span lines.
+static const char* next_string_close(
+	const char* open,
+	const char* prev,
+	const char* end) noexcept
+{
+	for (const char* p = prev + 1; p < end; ++p) {
+		if (*p == *open) return p;
+		if (*p == '\n' or *p == '\r') return nullptr;
+	}
+	
+	return nullptr;
+}
+
+// Enumerates the extents of the datum starting at begin in the order
+// std::regex would try them. Only strings have more than one.
+class datum_extents {
+	public:
+		datum_extents(const char* begin, const char* end) noexcept
+			: first(begin), last(end), close(nullptr), tried(false)
+		{}
+		
+		// Moves to the next extent. Returns false once none are left.
+		bool next() noexcept
+		{
+			if (first == last) return false;
+			
+			if (is_quote(*first)) {
+				const char* prev = close ? close : first;
+				close = next_string_close(first, prev, last);
+				
+				return close != nullptr;
+			} else if (tried) return false;
+			
+			tried = true;
+			close = scan_number(first, last);
+			if (not close) close = scan_name(first, last);
+			if (not close) close = scan_register(first, last);
+			if (not close) return false;
+			// So that the token end is uniform with strings.
+			--close;
+			
+			return true;
+		}
+		
+		// The end of the current extent.
+		const char* token_end() const noexcept
+		{
+			return close + 1;
+		}
+	
+	private:
+		const char* first;
+		const char* last;
+		const char* close;
+		bool tried;
 };
 
-static const regexopt regex_opts = regexc::icase | regexc::optimize;
-static const regexopt regex_consists_opts = regex_opts | regexc::nosubs;
-static const regex directive_consists \
-	(maag32pat::directive + "*", regex_consists_opts);
-static const regex directive_pat (maag32pat::directive, regex_opts);
-static const regex data_pat (maag32pat::datum, regex_opts);
+// Matches an optional comment and the newlines that end a directive at p.
+// Whitespace before the newlines only belongs to the grammar when a comment
+// follows it. Returns the end of the directive, or nullptr.
+static const char* match_directive_end(const char* p, const char* end) \
+	noexcept
+{
+	const char* q = skip_hws(p, end);
+	
+	if (q < end and *q == ';') {
+		q = static_cast<const char*>(std::memchr(q, '\n', end - q));
+		if (not q) return nullptr;
+	} else q = p;
+	
+	if (q == end or *q != '\n') return nullptr;
+	while (q < end and *q == '\n') ++q;
+	
+	return q;
+}
+
+// The extents of one directive within a source.
+struct raw_directive {
+	const char* begin = nullptr;
+	const char* end = nullptr;
+	const char* label = nullptr;
+	const char* label_end = nullptr;
+	const char* instr = nullptr;
+	const char* instr_end = nullptr;
+	const char* arg1 = nullptr;
+	const char* arg1_end = nullptr;
+	const char* arg2 = nullptr;
+	const char* arg2_end = nullptr;
+};
 
-std::string maag32::unescape_chars(const std::string& str)
+// Matches the data of an instruction starting at its first datum, as well
+// as the rest of the directive. Two data are tried before one, like the
+// pattern does.
+static bool match_data(const char* p, const char* end, raw_directive& dir) \
+	noexcept
 {
-	typedef std::string::const_iterator strit;
-	std::string newstr = "";
-	std::string strat = "";
+	datum_extents first (p, end);
 	
-	for (strit i = str.begin(); i < str.cend(); ++i) {
-		if (i + 1 == str.cend()) {
-			newstr += *i;
-		} else {
-			strat = "";
-			strat += *i;
-			strat += *(i + 1);
+	while (first.next()) {
+		const char* comma = skip_hws(first.token_end(), end);
+		if (comma == end or *comma != ',') continue;
+		const char* p2 = skip_hws(comma + 1, end);
+		datum_extents second (p2, end);
+		
+		while (second.next()) {
+			const char* q = skip_hws(second.token_end(), end);
+			q = match_directive_end(q, end);
 			
-			if (unescape.count(strat) != 0) {
-				newstr += unescape.at(strat);
-				++i;
-			} else {
-				newstr += *i;
+			if (q) {
+				dir.arg1 = p;
+				dir.arg1_end = first.token_end();
+				dir.arg2 = p2;
+				dir.arg2_end = second.token_end();
+				dir.end = q;
+				
+				return true;
 			}
 		}
 	}
 	
-	return newstr;
+	first = datum_extents(p, end);
+	
+	while (first.next()) {
+		const char* q = skip_hws(first.token_end(), end);
+		q = match_directive_end(q, end);
+		
+		if (q) {
+			dir.arg1 = p;
+			dir.arg1_end = first.token_end();
+			dir.end = q;
+			
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+// Matches a directive starting at p. Returns false if there isn't one.
+static bool match_directive(
+	const char* p,
+	const char* end,
+	raw_directive& dir) noexcept
+{
+	dir = raw_directive();
+	dir.begin = p;
+	p = skip_hws(p, end);
+	const char* name_end = scan_name(p, end);
+	
+	if (name_end) {
+		const char* colon = skip_hws(name_end, end);
+		
+		if (colon < end and *colon == ':') {
+			dir.label = p;
+			dir.label_end = name_end;
+			p = skip_hws(colon + 1, end);
+			name_end = scan_name(p, end);
+		}
+	}
+	
+	if (name_end) {
+		dir.instr = p;
+		dir.instr_end = name_end;
+		const char* data = skip_hws(name_end, end);
+		
+		if (data != name_end and match_data(data, end, dir)) return true;
+		
+		p = name_end;
+	}
+	
+	dir.end = match_directive_end(p, end);
+	
+	return dir.end != nullptr;
 }
 
-bool maag32::consists_of_directives(const std::string& str)
+static inline std::string_view to_view(const char* begin, const char* end)
 {
-	return std::regex_match(str, directive_consists);
+	return begin ? std::string_view(begin, end - begin) : std::string_view();
+}
+
+// Returns the number of newlines ending a directive.
+static std::size_t count_lines(const raw_directive& dir) noexcept
+{
+	const char* p = dir.end;
+	while (p > dir.begin and p[-1] == '\n') --p;
+	
+	return dir.end - p;
 }
 
-std::string::const_iterator maag32::find_first_nondirective(const std::string& str)
+static bool is_empty_directive(const raw_directive& dir) noexcept
 {
-	std::smatch results;
-	bool any_matches = std::regex_search(str, results, directive_pat);
+	return not dir.label and not dir.instr;
+}
+
+bool maag32::is_string_literal(std::string_view str) noexcept
+{
+	const char* begin = str.data();
+	const char* end = begin + str.size();
+	
+	if (str.size() < 2 or not is_quote(*begin)) return false;
+	
+	for (const char* p = begin + 1; p < end - 1; ++p) {
+		if (*p == '\n' or *p == '\r') return false;
+	}
 	
-	if (not any_matches) return str.cbegin();
-	if (results.prefix().matched) return results.prefix().first;
-	std::string leftovers = results.suffix();
-	std::string::const_iterator scit = find_first_nondirective(leftovers);
-	if (scit != leftovers.cend()) return scit;
+	return end[-1] == *begin;
+}
+
+bool maag32::is_register(std::string_view str) noexcept
+{
+	const char* begin = str.data();
+	const char* end = begin + str.size();
 	
-	return str.cend();
+	return not str.empty() and scan_register(begin, end) == end;
 }
 
-static maag32::directive_data parse_directive(const std::string& str)
+bool maag32::consists_of_directives(const std::string& str) noexcept
 {
-	maag32::directive_data data ("", "");
+	return find_first_nondirective(str) == str.cend();
+}
+
+std::string::const_iterator maag32::find_first_nondirective(
+	const std::string& str) noexcept
+{
+	const char* const begin = str.data();
+	const char* const end = begin + str.size();
+	const char* p = begin;
+	raw_directive dir;
 	
-	if (str == "") return data;
+	while (p < end and match_directive(p, end, dir)) p = dir.end;
 	
-	std::smatch results;
-	bool matched = std::regex_search(str, results, data_pat);
-	std::string leftovers = results.suffix();
+	return str.cbegin() + (p - begin);
+}
+
+maag32::parse_results::parse_results(
+	std::shared_ptr<const source_buffer> src) noexcept
+	: buffer(std::move(src))
+{}
+
+std::string_view maag32::parse_results::source() const noexcept
+{
+	return buffer ? buffer->view() : std::string_view();
+}
+
+maag32::parse_results::iterator maag32::parse_results::begin() noexcept
+{
+	return dirs.begin();
+}
+
+maag32::parse_results::iterator maag32::parse_results::end() noexcept
+{
+	return dirs.end();
+}
+
+maag32::parse_results::const_iterator maag32::parse_results::begin() const \
+	noexcept
+{
+	return dirs.begin();
+}
+
+maag32::parse_results::const_iterator maag32::parse_results::end() const \
+	noexcept
+{
+	return dirs.end();
+}
+
+maag32::parse_results::const_iterator maag32::parse_results::cbegin() const \
+	noexcept
+{
+	return dirs.cbegin();
+}
+
+maag32::parse_results::const_iterator maag32::parse_results::cend() const \
+	noexcept
+{
+	return dirs.cend();
+}
+
+maag32::parse_results::size_type maag32::parse_results::size() const noexcept
+{
+	return dirs.size();
+}
+
+bool maag32::parse_results::empty() const noexcept
+{
+	return dirs.empty();
+}
+
+maag32::directive& maag32::parse_results::operator[](size_type i) noexcept
+{
+	return dirs[i];
+}
+
+const maag32::directive& maag32::parse_results::operator[](size_type i) \
+	const noexcept
+{
+	return dirs[i];
+}
+
+void maag32::parse_results::push_back(const maag32::directive& dir)
+{
+	dirs.push_back(dir);
+}
+
+void maag32::parse_results::reserve(size_type n)
+{
+	dirs.reserve(n);
+}
+
+maag32::directive_scanner::directive_scanner(
+	std::string_view src,
+	std::size_t first_line) noexcept
+	: pos(src.data()), last(src.data() + src.size()), line_num(first_line)
+{}
+
+bool maag32::directive_scanner::next(maag32::directive& dir) noexcept
+{
+	raw_directive raw;
 	
-	if (matched and results[0] != "") {
-		data.first = results[1];
-		matched = std::regex_search(leftovers, results, data_pat);
-		
-		if (matched and results[0] != "") {
-			data.second = results[1];
+	while (pos < last) {
+		if (not match_directive(pos, last, raw)) {
+			bad = true;
+			
+			return false;
 		}
+		
+		const std::size_t line = line_num;
+		pos = raw.end;
+		line_num += count_lines(raw);
+		if (is_empty_directive(raw)) continue;
+		
+		const char* first = raw.label ? raw.label : raw.instr;
+		dir.original = to_view(raw.begin, raw.end);
+		dir.label = to_view(raw.label, raw.label_end);
+		dir.instr = to_view(raw.instr, raw.instr_end);
+		dir.data.first = to_view(raw.arg1, raw.arg1_end);
+		dir.data.second = to_view(raw.arg2, raw.arg2_end);
+		dir.line = line;
+		dir.column = first - raw.begin + 1;
+		dir.address = 0;
+		
+		return true;
 	}
 	
-	return data;
+	return false;
 }
 
-static bool is_empty_directive(const maag32::directive& dir) noexcept
+bool maag32::directive_scanner::failed() const noexcept
 {
-	return dir.label == "" and dir.instr == "";
+	return bad;
 }
 
-maag32::parse_results maag32::parse_source(const std::string& str)
+std::size_t maag32::directive_scanner::line() const noexcept
+{
+	return line_num;
+}
+
+// Sources smaller than this aren't worth splitting across threads.
+static constexpr std::size_t min_parallel_size = 1 << 18;
+// How many chunks to split a source into per thread, so that a thread that
+// gets dense chunks doesn't hold up the others.
+static constexpr std::size_t chunks_per_thread = 4;
+
+// Counts the newlines in [p, end).
+static std::size_t count_newlines(const char* p, const char* end) noexcept
 {
-	if (not consists_of_directives(str)) return {};
+	std::size_t count = 0;
 	
-	std::smatch results;
-	bool matched = std::regex_search(str, results, directive_pat);
-	parse_results parsed {};
-	maag32::directive dir;
-	std::string leftovers = results.suffix();
+#if defined(__SSE2__)
+	const __m128i newline = _mm_set1_epi8('\n');
+	
+	for (; end - p >= 64; p += 64) {
+		const __m128i* block = reinterpret_cast<const __m128i*>(p);
+		const unsigned m0 = _mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_loadu_si128(block), newline));
+		const unsigned m1 = _mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_loadu_si128(block + 1), newline));
+		const unsigned m2 = _mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_loadu_si128(block + 2), newline));
+		const unsigned m3 = _mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_loadu_si128(block + 3), newline));
+		count += __builtin_popcountll(
+			m0 | (m1 << 16) | (static_cast<unsigned long long>(m2) << 32) |
+			(static_cast<unsigned long long>(m3) << 48)
+		);
+	}
+#endif
+	
+	for (; p < end; ++p) count += *p == '\n';
+	
+	return count;
+}
+
+// Returns the start of the first directive at or after p. Newlines can't
+// appear inside strings or comments, so every directive starts right after
+// a run of newlines.
+static const char* next_directive_start(const char* p, const char* end) \
+	noexcept
+{
+	p = static_cast<const char*>(std::memchr(p, '\n', end - p));
+	if (not p) return end;
+	while (p < end and *p == '\n') ++p;
+	
+	return p;
+}
+
+// Returns the directive boundaries that split [begin, end) into up to
+// count chunks of roughly equal size, including begin and end.
+static std::vector<const char*> split_source(
+	const char* begin,
+	const char* end,
+	std::size_t count)
+{
+	const std::size_t step = (end - begin) / count;
+	std::vector<const char*> bounds {begin};
+	
+	for (std::size_t i = 1; i < count; i++) {
+		const char* start = std::max(begin + i * step, bounds.back());
+		start = next_directive_start(start, end);
+		if (start != end and start != bounds.back()) bounds.push_back(start);
+	}
+	
+	bounds.push_back(end);
+	
+	return bounds;
+}
+
+// Parses a source by splitting it into chunks at directive boundaries and
+// scanning the chunks on their own threads. The line number each chunk
+// starts at is found by counting newlines beforehand.
+static bool parse_parallel(
+	std::string_view src,
+	unsigned threads,
+	maag32::parse_results& parsed)
+{
+	typedef std::vector<maag32::directive> chunk_results;
 	
-	while (matched and results[0] != "") {
-		dir.original = results[0];
-		dir.label = results[1];
-		dir.instr = results[2];
-		dir.data = parse_directive(results[3]);
+	const std::vector<const char*> bounds = split_source(
+		src.data(),
+		src.data() + src.size(),
+		threads * chunks_per_thread
+	);
+	const std::size_t chunks = bounds.size() - 1;
+	std::vector<std::size_t> first_lines (chunks + 1, 0);
+	std::vector<chunk_results> results (chunks);
+	std::vector<char> failed (chunks, false);
+	
+	maag32::parallel_for(chunks, threads, [&](std::size_t i) {
+		first_lines[i + 1] = count_newlines(bounds[i], bounds[i + 1]);
+	});
+	
+	first_lines[0] = 1;
+	for (std::size_t i = 1; i <= chunks; i++)
+		first_lines[i] += first_lines[i - 1];
+	
+	maag32::parallel_for(chunks, threads, [&](std::size_t i) {
+		std::string_view chunk (bounds[i], bounds[i + 1] - bounds[i]);
+		maag32::directive_scanner scanner (chunk, first_lines[i]);
+		maag32::directive dir;
 		
-		if (not is_empty_directive(dir))
-			parsed.push_back(dir);
+		while (scanner.next(dir)) results[i].push_back(dir);
+		failed[i] = scanner.failed();
+	});
+	
+	std::size_t total = 0;
+	
+	for (std::size_t i = 0; i < chunks; i++) {
+		if (failed[i]) return false;
+		total += results[i].size();
+	}
+	
+	parsed.reserve(total);
+	
+	for (const chunk_results& chunk : results) {
+		for (const maag32::directive& dir : chunk) parsed.push_back(dir);
+	}
+	
+	return true;
+}
+
+maag32::parse_results maag32::parse_source(
+	std::shared_ptr<const source_buffer> src,
+	bool& success,
+	unsigned threads)
+{
+	const std::string_view text = src->view();
+	parse_results parsed (std::move(src));
+	
+	if (threads == 0) threads = hardware_threads();
+	
+	if (threads > 1 and text.size() >= min_parallel_size) {
+		success = parse_parallel(text, threads, parsed);
+		if (not success) return {};
 		
-		leftovers = results.suffix();
-		matched = std::regex_search(leftovers, results, directive_pat);
+		return parsed;
 	}
 	
+	directive_scanner scanner (text);
+	maag32::directive dir;
+	
+	while (scanner.next(dir)) parsed.push_back(dir);
+	
+	success = not scanner.failed();
+	if (not success) return {};
+	
 	return parsed;
 }
 
+maag32::parse_results maag32::parse_source(std::string str, bool& success)
+{
+	return parse_source(
+		std::make_shared<const source_buffer>(std::move(str)),
+		success
+	);
+}
+
+maag32::parse_results maag32::parse_source(std::string str)
+{
+	bool success = true;
+	
+	return parse_source(std::move(str), success);
+}
+
 // Has a strong exception guarantee.
 long long maag32::tonumber(
-	const std::string& str,
+	std::string_view str,
 	bool& success) noexcept
 {
 	try {
 		success = true;
 		
-		return std::stoll(str, nullptr, 0);
+		return std::stoll(std::string(str), nullptr, 0);
 	} catch (...) {
 		success = false;
 		
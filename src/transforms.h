@@ -23,68 +23,144 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #ifndef METROAAG32_HEADER_TRANSFORMS
 #define METROAAG32_HEADER_TRANSFORMS
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
 #include <metronome32/instruction.h>
+#include "source.h"
 
 namespace metroaag32 {
-	namespace patterns {
-		const std::string hws = "(?:[\\t ])*";
-		const std::string rhws = "(?:[\\t ])+";
-		const std::string decnum = "(?:[+-]?\\d+)";
-		const std::string hexnum = "(?:[+-]?0x[0-9a-f]+)";
-		const std::string octnum = "(?:[+-]?0[0-7]*)";
-		const std::string anynum = \
-			"(?:" + hexnum + "|" + octnum + "|" + decnum + ")";
-		const std::string name = \
-			"(?:[_a-z][_a-z0-9]*(?:\\.[_a-z][_a-z0-9]*)*)";
-		const std::string reg = "(?:%r\\d{1,2})";
-		const std::string str1 = "(?:\"(?:\\\"|\\\\|.)*?\")";
-		const std::string str2 = "(?:'(?:\\'|\\\\|.)*?')";
-		const std::string str = "(?:" + str1 + "|" + str2 + ")";
-		const std::string datum = \
-			"(?:" + hws + "(" + anynum + "|" + name + "|" + str + "|" + reg + ")" + hws + ")";
-		const std::string data = \
-			"(?:(?:" + datum + hws + "," + hws + ")?" + datum + ")";
-		const std::string label = \
-			"(?:(" + name + ")" + hws + ":" + hws + ")";
-		const std::string instr = \
-			"(?:(" + name + ")(?:" + rhws + "(" + data + "))?)";
-		const std::string comment = "(?:" + hws + ";[^\\n]*)";
-		const std::string directive = \
-			"(?:" + hws + label + "?" + instr + "?" + comment + \
-			"?\\n+)";
-	}
+	// The source grammar, case-insensitive. hws is horizontal whitespace
+	// (spaces and tabs), rhws is at least one of them.
+	//
+	//   source    := directive*
+	//   directive := hws label? instr? comment? '\n'+
+	//   label     := name hws ':' hws
+	//   instr     := name (rhws data)?
+	//   data      := (datum hws ',' hws)? datum
+	//   datum     := hws (number | name | string | register) hws
+	//   comment   := hws ';' [^\n]*
+	//   name      := [_a-z][_a-z0-9]* ('.' [_a-z][_a-z0-9]*)*
+	//   number    := [+-]? ('0x' [0-9a-f]+ | [0-9]+)
+	//   register  := '%r' [0-9]{1,2}
+	//   string    := '"' [^\r\n]* '"' | "'" [^\r\n]* "'"
+	//
+	// A string may close on any later matching quote of its line; the
+	// first one that lets the rest of the directive match is used.
 	
-	typedef std::pair<std::string, std::string> directive_data;
-
+	typedef std::pair<std::string_view, std::string_view> directive_data;
+	
+	// A directive refers to its text in the source buffer retained by the
+	// parse_results holding it, so it never allocates.
 	struct directive {
-		std::string original = "";
-		std::string label = "";
-		std::string instr = "";
+		std::string_view original = {};
+		std::string_view label = {};
+		std::string_view instr = {};
 		directive_data data = {};
+		// 1-based position of the directive's label or instruction.
+		std::size_t line = 0;
+		std::size_t column = 0;
 		metronome32::register_value address = 0;
 	};
 	
-	typedef std::vector<directive> parse_results;
+	// The directives of a source, along with the source buffer they view.
+	class parse_results {
+		public:
+			typedef std::vector<directive> container;
+			typedef container::iterator iterator;
+			typedef container::const_iterator const_iterator;
+			typedef container::size_type size_type;
+			
+			parse_results() = default;
+			explicit parse_results(
+				std::shared_ptr<const source_buffer> src
+			) noexcept;
+			
+			// The buffer that all directives view.
+			std::string_view source() const noexcept;
+			
+			iterator begin() noexcept;
+			iterator end() noexcept;
+			const_iterator begin() const noexcept;
+			const_iterator end() const noexcept;
+			const_iterator cbegin() const noexcept;
+			const_iterator cend() const noexcept;
+			size_type size() const noexcept;
+			bool empty() const noexcept;
+			directive& operator[](size_type i) noexcept;
+			const directive& operator[](size_type i) const noexcept;
+			void push_back(const directive& dir);
+			void reserve(size_type n);
+		
+		private:
+			std::shared_ptr<const source_buffer> buffer;
+			container dirs;
+	};
+	
+	// Scans the directives of a source one at a time, validating as it
+	// goes. Used by parse_source and by the streaming assembler.
+	class directive_scanner;
 	
 	// Unescapes all backslash escapes in a string.
-	std::string unescape_chars(const std::string& str);
+	std::string unescape_chars(std::string_view str);
+	// Returns whether a string is a string literal datum.
+	bool is_string_literal(std::string_view str) noexcept;
+	// Returns whether a string is a register datum.
+	bool is_register(std::string_view str) noexcept;
 	// Returns whether a string consists of only directives.
 	// Add a '\n' to the end of the string if one isn't present.
-	bool consists_of_directives(const std::string& str);
-	// Returns an iterator to the first non-directive character.
+	bool consists_of_directives(const std::string& str) noexcept;
+	// Returns an iterator to the start of the first non-directive line.
 	// If the return value is str.cend(), it's all directives.
 	// Add a '\n' to the end of the string if one isn't present.
 	std::string::const_iterator \
-		find_first_nondirective(const std::string& str);
+		find_first_nondirective(const std::string& str) noexcept;
+	// Returns all directives of a source string, validating it in the
+	// same pass. The results keep the string alive. If the entire string
+	// isn't directives, success is false and {} is returned. Large sources
+	// are split at directive boundaries and parsed on up to threads
+	// threads (0 meaning one per core), with the same results as parsing
+	// on one.
+	parse_results parse_source(
+		std::shared_ptr<const source_buffer> src,
+		bool& success,
+		unsigned threads = 1
+	);
+	parse_results parse_source(std::string str, bool& success);
 	// Returns all directives of a source string.
 	// If the entire string isn't directives, {} is returned.
-	parse_results parse_source(const std::string& str);
+	parse_results parse_source(std::string str);
 	// Converts a number string to a LL. Only well-defined if success is
 	// true.
-	long long tonumber(const std::string& str, bool& success) noexcept;
+	long long tonumber(std::string_view str, bool& success) noexcept;
 }
 
+class metroaag32::directive_scanner
+{
+	public:
+		// first_line is the line number of the start of src.
+		explicit directive_scanner(
+			std::string_view src,
+			std::size_t first_line = 1
+		) noexcept;
+		
+		// Moves to the next non-empty directive and places it in dir,
+		// viewing the scanned source. Returns false at the end of the
+		// source or at an invalid directive.
+		bool next(directive& dir) noexcept;
+		// Whether scanning stopped at an invalid directive.
+		bool failed() const noexcept;
+		// The line number of the next directive.
+		std::size_t line() const noexcept;
+	
+	private:
+		const char* pos;
+		const char* last;
+		std::size_t line_num;
+		bool bad = false;
+};
+
 #endif
@@ -0,0 +1,103 @@
+/*
+Copyright (c) 2019 Grayson Burton ( https://github.com/ocornoc/ )
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Times parse_source on synthetic sources of doubling size. The time per
+// line should stay flat as the sources grow. Usage:
+// parse_bench [MAX_LINES] [THREADS]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "transforms.h"
+namespace maag32 = metroaag32;
+
+static const char* const lines[] = {
+	"loop:\taddi\t%r1, -1\t; count down\n",
+	"\tadd\t%r2, %r3\n",
+	"\tbgez\t%r1, loop\n",
+	"\tdw\t0xDBDBDBDB, 4\n",
+	"msg:\tdsz\t\"Hello, world!\\n\"\n",
+	"\t; a comment line\n",
+	"\tj\tdone\n",
+	"\n",
+};
+
+static constexpr std::size_t line_kinds = sizeof(lines) / sizeof(*lines);
+
+// Labels are numbered so that a source never has duplicates.
+static std::string make_source(std::size_t line_count)
+{
+	std::string src;
+	
+	for (std::size_t i = 0; i < line_count; i++) {
+		const std::string line = lines[i % line_kinds];
+		
+		if (line.compare(0, 4, "loop") == 0 or line.compare(0, 3, "msg") == 0)
+			src += "l" + std::to_string(i) + "_";
+		
+		src += line;
+	}
+	
+	return src;
+}
+
+int main(const int argc, const char** argv)
+{
+	typedef std::chrono::steady_clock clock;
+	const std::size_t max_lines = argc > 1 ? std::strtoull(argv[1], nullptr, 0)
+		: 1 << 20;
+	const unsigned threads = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : 1;
+	
+	std::cout << std::setw(10) << "lines" << std::setw(12) << "bytes";
+	std::cout << std::setw(12) << "ms" << std::setw(12) << "ns/line";
+	std::cout << std::endl;
+	
+	for (std::size_t n = 1 << 10; n <= max_lines; n *= 2) {
+		const std::shared_ptr<const maag32::source_buffer> src = \
+			std::make_shared<const maag32::source_buffer>(make_source(n));
+		bool success = true;
+		const clock::time_point start = clock::now();
+		const maag32::parse_results pr = maag32::parse_source(
+			src,
+			success,
+			threads
+		);
+		const clock::duration took = clock::now() - start;
+		const double ns = std::chrono::duration<double, std::nano>(took).count();
+		
+		if (not success or pr.empty()) {
+			std::cout << "Generated source failed to parse." << std::endl;
+			
+			return EXIT_FAILURE;
+		}
+		
+		std::cout << std::setw(10) << n << std::setw(12) << src->size();
+		std::cout << std::setw(12) << std::fixed << std::setprecision(2);
+		std::cout << ns / 1e6 << std::setw(12) << ns / n << std::endl;
+	}
+	
+	return EXIT_SUCCESS;
+}